@@ -0,0 +1,154 @@
+/*
+ * AnalysisCommon.h
+ *
+ * Description:
+ * Helpers shared by the analysis macros in this directory:
+ * - the default list of Monte Carlo samples and of the PuppiMET systematic variations,
+ * - splitting a TTree into entry ranges along its cluster boundaries for parallel processing,
+ *   and building the task list of all samples (analysisRanges()),
+ * - naming files stored next to a sample, and attaching the friend tree written by projected_MET().
+ *
+ * Include it from a macro with: #include "AnalysisCommon.h"
+ */
+
+#ifndef ANALYSIS_COMMON_H
+#define ANALYSIS_COMMON_H
+
+#include <TFile.h>
+#include <TFriendElement.h>
+#include <TTree.h>
+#include <TSystem.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Name of the friend tree holding delta_phi_1/2, delta_phi_min and projected_MET
+const char *const projectedMETTreeName = "projMET";
+
+// Systematic variations of PuppiMET kept by branch_extractor(), read from the branches
+// PuppiMET_pt<variation> and PuppiMET_phi<variation>. projected_MET() in systematics mode
+// writes projected_MET_<variation> for each of them.
+const int kNMETVariations = 6;
+
+inline std::vector<std::string> metVariations() {
+    return {"JESUp", "JESDown", "JERUp", "JERDown", "UnclusteredUp", "UnclusteredDown"};
+}
+
+inline std::vector<std::string> defaultSamples() {
+    return {
+        "DYtoLL_M50.root",
+        "TTTo2L2Nu.root",
+        "WZ.root",
+        "ZZ.root",
+        "WWTo2L2Nu.root",
+        "SingleTop.root"
+    };
+}
+
+// A contiguous block of whole clusters of one sample, processed by a single task
+struct EntryRange {
+    size_t sample;
+    Long64_t first;
+    Long64_t last;   // exclusive
+};
+
+// Split the tree into roughly 'nChunks' ranges without cutting through a cluster,
+// so that no two tasks have to decompress the same basket. With maxEntries > 0 no range
+// is longer than maxEntries, except a single cluster that is longer on its own.
+inline void appendClusterRanges(TTree *tree, size_t sample, UInt_t nChunks, std::vector<EntryRange> &ranges,
+                                Long64_t maxEntries = 0) {
+    Long64_t nEntries = tree->GetEntries();
+    Long64_t target = std::max<Long64_t>(1, nEntries / std::max<UInt_t>(1, nChunks));
+    if (maxEntries > 0) target = std::min(target, maxEntries);
+
+    TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+    Long64_t start = 0, clusterStart;
+    while ((clusterStart = clusters()) < nEntries) {
+        Long64_t clusterEnd = std::min(clusters.GetNextEntry(), nEntries);
+        if (maxEntries > 0 && clusterStart > start && clusterEnd - start > maxEntries) {
+            ranges.push_back({sample, start, clusterStart});
+            start = clusterStart;
+        }
+        if (clusterEnd - start >= target || clusterEnd >= nEntries) {
+            ranges.push_back({sample, start, clusterEnd});
+            start = clusterEnd;
+        }
+    }
+    if (start < nEntries) ranges.push_back({sample, start, nEntries});
+}
+
+// File stored next to a sample: siblingFile("WWTo2L2Nu.root", "_projMET.root") -> "WWTo2L2Nu_projMET.root"
+inline std::string siblingFile(const std::string &sample, const std::string &suffix) {
+    std::string base = sample;
+    if (base.size() > 5 && base.compare(base.size() - 5, 5, ".root") == 0) {
+        base.erase(base.size() - 5);
+    }
+    return base + suffix;
+}
+
+// "WWTo2L2Nu.root" -> "WWTo2L2Nu_projMET.root"
+inline std::string projectedMETFriendFile(const std::string &sample) {
+    return siblingFile(sample, "_projMET.root");
+}
+
+// Make projected_MET (and the delta_phi variables) readable from 'tree'.
+// Files produced by the old in-place version of projected_MET() already carry the branch;
+// otherwise the friend file written by projected_MET() is attached.
+// Returns false if the variables are not available, or if the friend tree does not have
+// exactly one entry per entry of 'tree' (its values would belong to other events).
+inline bool attachProjectedMETFriend(TTree *tree, const std::string &sample) {
+    if (tree->GetBranch("projected_MET")) return true;
+
+    std::string friendFile = projectedMETFriendFile(sample);
+    if (gSystem->AccessPathName(friendFile.c_str())) return false;   // kTRUE if missing
+    TFriendElement *element = tree->AddFriend(projectedMETTreeName, friendFile.c_str());
+    TTree *friendTree = element ? element->GetTree() : nullptr;
+    if (!friendTree) return false;
+    if (friendTree->GetEntries() != tree->GetEntries()) {
+        std::cerr << "Error: " << friendFile << " has " << friendTree->GetEntries() << " entries, "
+                  << sample << " has " << tree->GetEntries() << "; run projected_MET(\"" << sample
+                  << "\") again" << std::endl;
+        tree->RemoveFriend(friendTree);
+        return false;
+    }
+    return tree->GetBranch("projected_MET") != nullptr;
+}
+
+// Build the task list from the cluster layout of every sample. Samples whose file, tree,
+// projected_MET friend or any of 'requiredBranches' is missing are skipped with an error.
+inline std::vector<EntryRange> analysisRanges(const std::vector<std::string> &samples, UInt_t nThreads,
+                                              const std::vector<std::string> &requiredBranches = {}) {
+    std::vector<EntryRange> ranges;
+    for (size_t s = 0; s < samples.size(); s++) {
+        TFile *file = TFile::Open(samples[s].c_str());
+        if (!file || file->IsZombie()) {
+            std::cerr << "Error opening the ROOT file " << samples[s] << std::endl;
+            delete file;
+            continue;
+        }
+        TTree *tree = (TTree*)file->Get("Events");
+        if (!tree) {
+            std::cerr << "Error getting the TTree from the ROOT file " << samples[s] << std::endl;
+        } else if (!attachProjectedMETFriend(tree, samples[s])) {
+            std::cerr << "No projected_MET for " << samples[s] << ", run projected_MET(\"" << samples[s] << "\") first" << std::endl;
+        } else {
+            bool complete = true;
+            for (const auto &name : requiredBranches) {
+                if (!tree->GetBranch(name.c_str())) {
+                    std::cerr << "Error: branch " << name << " not found for " << samples[s];
+                    if (name.compare(0, 14, "projected_MET_") == 0) {
+                        std::cerr << ", run projected_MET(\"" << samples[s] << "\", 0, true) first";
+                    }
+                    std::cerr << std::endl;
+                    complete = false;
+                }
+            }
+            if (complete) appendClusterRanges(tree, s, 4 * nThreads, ranges);
+        }
+        delete file;
+    }
+    return ranges;
+}
+
+#endif
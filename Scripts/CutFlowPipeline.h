@@ -0,0 +1,589 @@
+/*
+ * CutFlowPipeline.h
+ *
+ * Description:
+ * Declarative cut-flow pipeline used by Electron_Cut_Flow.C and superimposed_plots.C.
+ * Every selection stage is data: a name, the inputs it reads and a predicate.
+ * The pipeline evaluates the stages and records, per stage:
+ *  - unweighted and weighted (sum of weights, sum of squared weights) event counts,
+ *  - the time spent in branch I/O (TBranch::GetEntry, incl. decompression),
+ *  - the time spent in the predicate itself.
+ *
+ * Inputs are branches or the dielectron quantities mll, ptll and dphill, which the pipeline
+ * derives itself. Events reaching the first stage that needs them are buffered, and the SIMD
+ * kernel of DielectronKinematics.h computes the whole block (up to kCutFlowBatchSize
+ * candidates, never across a cluster boundary) before the remaining stages run on it.
+ *
+ * The first stage selects the electron pair and always runs first. The later stages only
+ * read the event, so their order is free: by default they run as declared, and
+ * OrderByRejection() sorts them by the rejection measured with Run(..., independent = true).
+ * Counts are cumulative in evaluation order (CutFlowResult::order).
+ *
+ * Lazy mode (default) reads the branches of a stage only when the event reaches it,
+ * so events rejected by the tight-electron requirement never decompress Electron_phi
+ * or projected_MET. Eager mode reads the branches of all stages up front, like
+ * tree->GetEntry(i) did, books that I/O time on the first stage and evaluates one event
+ * at a time. In both modes the branches are read through a TTreeCache that holds exactly
+ * the branches the stages and outputs use, limited to the entry range of the task.
+ *
+ * The thresholds of the standard dielectron selection live in DielectronCuts;
+ * dielectronCutStages() turns them into the six stages of the analysis.
+ */
+
+#ifndef CUT_FLOW_PIPELINE_H
+#define CUT_FLOW_PIPELINE_H
+
+#include <TBranch.h>
+#include <TLeaf.h>
+#include <TString.h>
+#include <TTree.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "AnalysisCommon.h"
+#include "DielectronKinematics.h"
+
+const int kMaxElectrons = 100;
+
+// Candidates buffered before the kinematics kernel runs on them
+const size_t kCutFlowBatchSize = 4096;
+
+// Branch values of the current event, plus the quantities derived by the pipeline
+struct CutFlowEvent {
+    Long64_t entry = -1;
+    UInt_t nElectron = 0;
+    Float_t Electron_pt[kMaxElectrons];
+    Float_t Electron_eta[kMaxElectrons];
+    Float_t Electron_phi[kMaxElectrons];
+    Int_t Electron_pdgId[kMaxElectrons];
+    Bool_t Electron_mvaFall17V2Iso_WP90[kMaxElectrons];
+    Float_t projected_MET = 0;
+    Float_t projected_MET_variation[kNMETVariations] = {};   // in the order of metVariations()
+    Float_t weight = 1;
+
+    // Derived: the pair chosen by the first stage (pT ordered once the kinematics are computed)
+    int lead = -1, sublead = -1;
+    // Derived by the kernel, for events that reached a stage using mll, ptll or dphill.
+    // Electron arrays of such events are only current for the branches of later stages and outputs.
+    float ptLead = 0, etaLead = 0, phiLead = 0;
+    float ptSub = 0, etaSub = 0, phiSub = 0;
+    float mll = 0, ptll = 0, dphill = 0;
+};
+
+// Address of the CutFlowEvent member a branch is read into (nullptr if unknown)
+inline void *cutFlowBranchAddress(CutFlowEvent &ev, const std::string &name) {
+    if (name == "nElectron") return &ev.nElectron;
+    if (name == "Electron_pt") return ev.Electron_pt;
+    if (name == "Electron_eta") return ev.Electron_eta;
+    if (name == "Electron_phi") return ev.Electron_phi;
+    if (name == "Electron_pdgId") return ev.Electron_pdgId;
+    if (name == "Electron_mvaFall17V2Iso_WP90") return ev.Electron_mvaFall17V2Iso_WP90;
+    if (name == "projected_MET") return &ev.projected_MET;
+    if (name.compare(0, 14, "projected_MET_") == 0) {
+        std::vector<std::string> variations = metVariations();
+        for (int v = 0; v < kNMETVariations; v++) {
+            if (name.compare(14, std::string::npos, variations[v]) == 0) return &ev.projected_MET_variation[v];
+        }
+    }
+    return nullptr;
+}
+
+// Inputs computed by the pipeline from the selected pair rather than read from a branch
+inline bool isDielectronQuantity(const std::string &name) {
+    return name == "mll" || name == "ptll" || name == "dphill";
+}
+
+// Entries that passed the first cut stage, in increasing order, with the electron pair it
+// selected (filled from the pre-selection cache, see PreselectionCache.h)
+struct PreselectedEntries {
+    std::string selection;           // name of the stage the list was built with
+    std::vector<Long64_t> entries;
+    std::vector<UChar_t> lead;
+    std::vector<UChar_t> sublead;
+};
+
+// The first stage of a pipeline may set ev.lead/ev.sublead; later stages must not modify the event.
+struct CutStage {
+    std::string name;
+    std::vector<std::string> inputs;                 // branches and derived quantities the predicate reads
+    std::function<bool(CutFlowEvent &)> predicate;
+};
+
+struct StageStats {
+    Long64_t evaluated = 0;    // events that reached the stage
+    Long64_t passed = 0;
+    double sumw = 0, sumw2 = 0;
+    double ioSeconds = 0, computeSeconds = 0;
+
+    void Add(const StageStats &o) {
+        evaluated += o.evaluated;
+        passed += o.passed;
+        sumw += o.sumw;
+        sumw2 += o.sumw2;
+        ioSeconds += o.ioSeconds;
+        computeSeconds += o.computeSeconds;
+    }
+};
+
+struct CutFlowResult {
+    Long64_t nEntries = 0;
+    Long64_t nMissing = 0;           // entries of ranges that could not be read (table incomplete)
+    double sumw = 0;
+    std::string weightBranch;        // branch the weights came from, empty for unit weights
+    std::vector<size_t> order;       // evaluation order of the stages (indices into stages)
+    std::vector<StageStats> stages;  // in declaration order
+
+    void Add(const CutFlowResult &o) {
+        nEntries += o.nEntries;
+        nMissing += o.nMissing;
+        sumw += o.sumw;
+        if (weightBranch.empty()) weightBranch = o.weightBranch;
+        if (order.empty()) order = o.order;
+        if (stages.size() < o.stages.size()) stages.resize(o.stages.size());
+        for (size_t s = 0; s < o.stages.size(); s++) stages[s].Add(o.stages[s]);
+    }
+};
+
+class CutFlowPipeline {
+public:
+    // weightBranch: per-event weight branch (e.g. "genWeight"); trees without it get unit weights
+    CutFlowPipeline(std::vector<CutStage> stages, bool lazy = true, std::string weightBranch = "")
+        : fStages(std::move(stages)), fLazy(lazy), fWeightBranch(std::move(weightBranch)), fOrder(fStages.size()) {
+        std::iota(fOrder.begin(), fOrder.end(), 0);
+    }
+
+    const std::vector<CutStage> &stages() const { return fStages; }
+    const std::vector<size_t> &order() const { return fOrder; }
+    bool lazy() const { return fLazy; }
+
+    // Evaluate the stages after the first in increasing order of the fraction of events
+    // passing them in 'measured' (a Run with independent = true), so the stage rejecting most
+    // events runs first. Stages with equal fractions keep their declared order.
+    void OrderByRejection(const CutFlowResult &measured) {
+        auto fraction = [&](size_t s) {
+            const StageStats &st = measured.stages[s];
+            return st.evaluated > 0 ? double(st.passed) / st.evaluated : 1.0;
+        };
+        if (measured.stages.size() != fStages.size() || fOrder.size() < 2) return;
+        std::stable_sort(fOrder.begin() + 1, fOrder.end(), [&](size_t a, size_t b) { return fraction(a) < fraction(b); });
+    }
+
+    // Evaluate the stages on the entries [first, last) of 'tree'. For every event passing all
+    // stages the 'outputs' branches are read and onPass is called (it may change the event;
+    // the pipeline does not read it back). Safe to call concurrently on different TTree
+    // objects: all per-run state lives on the stack.
+    //
+    // If 'preselected' lists the entries passing the first stage (its 'selection' must match the
+    // name of stage 1), only those entries are read and stage 1 is not evaluated again; its
+    // counts are taken from the list. The sum of weights of all entries (result.sumw) is then
+    // not available and left at 0.
+    //
+    // With 'independent' every stage is evaluated for every event passing the first one, so
+    // each stage's counts measure that cut alone (see OrderByRejection()); onPass is not called.
+    CutFlowResult Run(TTree *tree, Long64_t first, Long64_t last,
+                      const std::vector<std::string> &outputs = {},
+                      std::function<void(CutFlowEvent &)> onPass = nullptr,
+                      const PreselectedEntries *preselected = nullptr, bool independent = false) const {
+        typedef std::chrono::steady_clock Clock;
+        auto seconds = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+
+        CutFlowResult result;
+        result.stages.resize(fStages.size());
+        result.order = fOrder;
+        if (fStages.empty()) return result;
+
+        bool usePreselection = preselected && preselected->selection == fStages[0].name;
+        if (preselected && !usePreselection) {
+            std::cerr << "Warning: pre-selection '" << preselected->selection
+                      << "' does not match the first cut stage, reading all entries" << std::endl;
+        }
+        size_t firstPos = usePreselection ? 1 : 0;   // first position of fOrder that is evaluated
+
+        CutFlowEvent ev;
+        Float_t weightValue = 1;
+        std::vector<TBranch *> branches;
+        std::vector<std::string> names;
+        std::vector<Long64_t> loadedEntry;
+        int countBranch = -1;
+
+        // Index of a branch in 'branches', binding it (and its count branch first) on first use
+        std::function<int(const std::string &)> bind = [&](const std::string &name) -> int {
+            for (size_t b = 0; b < names.size(); b++) if (names[b] == name) return (int)b;
+            TBranch *branch = tree->GetBranch(name.c_str());
+            void *address = (name == fWeightBranch) ? &weightValue : cutFlowBranchAddress(ev, name);
+            if (!branch || !address) {
+                std::cerr << "Error: cut flow input '" << name << "' not available" << std::endl;
+                return -1;
+            }
+            TLeaf *leaf = branch->GetLeaf(name.c_str());
+            if (leaf && leaf->GetLeafCount() && bind(leaf->GetLeafCount()->GetName()) < 0) return -1;
+            branch->SetAddress(address);
+            branches.push_back(branch);
+            names.push_back(name);
+            loadedEntry.push_back(-1);
+            if (name == "nElectron") countBranch = (int)branches.size() - 1;
+            return (int)branches.size() - 1;
+        };
+
+        // Branch indices of a list of inputs, count branches ahead of the arrays they size.
+        // Derived quantities are skipped and reported through 'derived'.
+        auto resolve = [&](const std::vector<std::string> &inputs, std::vector<int> &indices, bool *derived = nullptr) {
+            for (const auto &name : inputs) {
+                if (derived && isDielectronQuantity(name)) {
+                    *derived = true;
+                    continue;
+                }
+                int b = bind(name);
+                if (b < 0) return false;
+                TLeaf *leaf = branches[b]->GetLeaf(name.c_str());
+                if (leaf && leaf->GetLeafCount()) indices.push_back(bind(leaf->GetLeafCount()->GetName()));
+                indices.push_back(b);
+            }
+            return true;
+        };
+
+        std::vector<std::vector<int>> stageBranches(fStages.size());
+        std::vector<char> needsKinematics(fStages.size(), 0);
+        for (size_t p = firstPos; p < fOrder.size(); p++) {
+            size_t s = fOrder[p];
+            bool derived = false;
+            if (!resolve(fStages[s].inputs, stageBranches[s], &derived)) return result;
+            needsKinematics[s] = derived;
+        }
+        std::vector<int> weightBranches, kinematicsBranches, outputBranches;
+        if (!fWeightBranch.empty() && tree->GetBranch(fWeightBranch.c_str())) {
+            if (!resolve({fWeightBranch}, weightBranches)) return result;
+            result.weightBranch = fWeightBranch;
+        }
+        if (!resolve(outputs, outputBranches)) return result;
+
+        // Stages from the first one using the derived quantities run on the computed batch
+        size_t boundary = std::max<size_t>(firstPos, 1);
+        while (boundary < fOrder.size() && !needsKinematics[fOrder[boundary]]) boundary++;
+        if (boundary < fOrder.size() && !resolve({"Electron_pt", "Electron_eta", "Electron_phi"}, kinematicsBranches)) {
+            return result;
+        }
+
+        // Eager mode: everything any stage needs is read before the first stage
+        size_t firstStage = fOrder[std::min(firstPos, fOrder.size() - 1)];
+        if (!fLazy && firstPos < fOrder.size()) {
+            std::vector<int> &all = stageBranches[firstStage];
+            for (size_t p = firstPos + 1; p < fOrder.size(); p++) {
+                std::vector<int> &own = stageBranches[fOrder[p]];
+                all.insert(all.end(), own.begin(), own.end());
+                own.clear();
+            }
+            all.insert(all.end(), kinematicsBranches.begin(), kinematicsBranches.end());
+        }
+        size_t batchSize = fLazy ? kCutFlowBatchSize : 1;
+
+        // Read the bound branches through TTreeCache: one cache per tree (friends have their
+        // own), holding only these branches and only this entry range
+        std::vector<TTree *> cachedTrees;
+        for (TBranch *branch : branches) {
+            TTree *t = branch->GetTree();
+            if (std::find(cachedTrees.begin(), cachedTrees.end(), t) == cachedTrees.end()) {
+                t->SetCacheSize(-1);
+                t->SetCacheEntryRange(first, last);
+                cachedTrees.push_back(t);
+            }
+            t->AddBranchToCache(branch, true);
+        }
+        for (TTree *t : cachedTrees) t->StopCacheLearningPhase();
+
+        bool warnedOverflow = false;
+        Long64_t treeEntry = -1;
+        auto load = [&](const std::vector<int> &indices, Long64_t entry) {
+            if (entry != treeEntry) {
+                if (tree->LoadTree(entry) < 0) return false;   // also positions the friend trees
+                treeEntry = entry;
+            }
+            for (int b : indices) {
+                if (loadedEntry[b] == entry) continue;
+                if (branches[b]->GetEntry(entry) < 0) return false;
+                loadedEntry[b] = entry;
+                if (b == countBranch && ev.nElectron > (UInt_t)kMaxElectrons) {
+                    if (!warnedOverflow) {
+                        std::cerr << "Warning: entry " << entry << " has " << ev.nElectron
+                                  << " electrons (> " << kMaxElectrons << "), event skipped" << std::endl;
+                        warnedOverflow = true;
+                    }
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        // Evaluate the stage at position p of the evaluation order on the current event
+        auto runStage = [&](size_t p) {
+            size_t s = fOrder[p];
+            StageStats &stats = result.stages[s];
+            stats.evaluated++;
+
+            Clock::time_point t0 = Clock::now();
+            bool pass = load(stageBranches[s], ev.entry);
+            Clock::time_point t1 = Clock::now();
+            pass = pass && fStages[s].predicate(ev);
+            Clock::time_point t2 = Clock::now();
+
+            stats.ioSeconds += seconds(t0, t1);
+            stats.computeSeconds += seconds(t1, t2);
+            if (pass) {
+                stats.passed++;
+                stats.sumw += ev.weight;
+                stats.sumw2 += ev.weight * ev.weight;
+            }
+            return pass;
+        };
+
+        // Positions [begin, end) of the evaluation order; all of them in independent mode
+        auto runStages = [&](size_t begin, size_t end) {
+            bool pass = true;
+            for (size_t p = begin; p < end && (pass || independent); p++) pass = runStage(p) && pass;
+            return pass;
+        };
+
+        auto finish = [&]() {
+            if (!independent && onPass && load(outputBranches, ev.entry)) onPass(ev);
+        };
+
+        struct Pending {
+            Long64_t entry;
+            int lead, sublead;
+            float weight;
+        };
+        DielectronBatch batch;
+        std::vector<Pending> pending;
+
+        // Compute the kinematics of the buffered candidates, then run the remaining stages on them
+        auto flush = [&]() {
+            if (pending.empty()) return;
+            StageStats &kinematics = result.stages[fOrder[boundary]];
+            Clock::time_point t0 = Clock::now();
+            batch.compute();
+            kinematics.computeSeconds += seconds(t0, Clock::now());
+
+            for (size_t k = 0; k < pending.size(); k++) {
+                ev.entry = pending[k].entry;
+                ev.lead = pending[k].lead;
+                ev.sublead = pending[k].sublead;
+                ev.weight = pending[k].weight;
+                ev.ptLead = batch.pt1[k]; ev.etaLead = batch.eta1[k]; ev.phiLead = batch.phi1[k];
+                ev.ptSub = batch.pt2[k]; ev.etaSub = batch.eta2[k]; ev.phiSub = batch.phi2[k];
+                ev.mll = batch.mll[k];
+                ev.ptll = batch.ptll[k];
+                ev.dphill = batch.dphill[k];
+                if (runStages(boundary, fOrder.size())) finish();
+            }
+            batch.clear();
+            pending.clear();
+        };
+
+        auto processEntry = [&](Long64_t entry) {
+            ev.entry = entry;
+            weightValue = 1;
+
+            StageStats &firstStats = result.stages[firstStage];
+            Clock::time_point t0 = Clock::now();
+            bool ok = load(weightBranches, entry);
+            firstStats.ioSeconds += seconds(t0, Clock::now());
+            double w = ev.weight = weightValue;
+            if (usePreselection) {
+                result.stages[0].sumw += w;
+                result.stages[0].sumw2 += w * w;
+            } else {
+                result.sumw += w;
+            }
+            if (!ok) {
+                firstStats.evaluated++;
+                return;
+            }
+
+            // The pair selection gates every event, also in independent mode
+            if (firstPos == 0 && !runStage(0)) return;
+            if (!runStages(std::max<size_t>(firstPos, 1), boundary) && !independent) return;
+            if (boundary == fOrder.size()) {
+                finish();
+                return;
+            }
+
+            // Gather the pT-ordered pair; its I/O is booked on the first stage using it
+            StageStats &kinematics = result.stages[fOrder[boundary]];
+            t0 = Clock::now();
+            ok = load(kinematicsBranches, entry);
+            kinematics.ioSeconds += seconds(t0, Clock::now());
+            if (!ok) {
+                kinematics.evaluated++;
+                return;
+            }
+            if (ev.Electron_pt[ev.sublead] > ev.Electron_pt[ev.lead]) std::swap(ev.lead, ev.sublead);
+            int l = ev.lead, s = ev.sublead;
+            batch.push_back(ev.Electron_pt[l], ev.Electron_eta[l], ev.Electron_phi[l],
+                            ev.Electron_pt[s], ev.Electron_eta[s], ev.Electron_phi[s]);
+            pending.push_back({entry, ev.lead, ev.sublead, ev.weight});
+            if (pending.size() >= batchSize) flush();
+        };
+
+        // A block never spans two clusters, so the cache does not go back to a cluster it left
+        TTree::TClusterIterator clusters = tree->GetClusterIterator(first);
+        clusters();
+        Long64_t clusterEnd = clusters.GetNextEntry();
+        auto nextEntry = [&](Long64_t entry) {
+            if (entry < clusterEnd) return;
+            flush();
+            while (entry >= clusterEnd) {
+                clusters();
+                Long64_t next = clusters.GetNextEntry();
+                if (next <= clusterEnd) break;
+                clusterEnd = next;
+            }
+        };
+
+        result.nEntries = last - first;
+        if (usePreselection) {
+            const std::vector<Long64_t> &list = preselected->entries;
+            size_t begin = std::lower_bound(list.begin(), list.end(), first) - list.begin();
+            size_t end = std::lower_bound(list.begin(), list.end(), last) - list.begin();
+            result.stages[0].evaluated = last - first;
+            result.stages[0].passed = end - begin;
+            for (size_t k = begin; k < end; k++) {
+                nextEntry(list[k]);
+                ev.lead = preselected->lead[k];
+                ev.sublead = preselected->sublead[k];
+                processEntry(list[k]);
+            }
+        } else {
+            for (Long64_t entry = first; entry < last; entry++) {
+                nextEntry(entry);
+                ev.lead = ev.sublead = -1;
+                processEntry(entry);
+            }
+        }
+        flush();
+
+        return result;
+    }
+
+private:
+    std::vector<CutStage> fStages;
+    bool fLazy;
+    std::string fWeightBranch;
+    std::vector<size_t> fOrder;   // evaluation order, fOrder[0] == 0
+};
+
+// Thresholds of the dielectron selection (GeV for momenta and masses)
+struct DielectronCuts {
+    float leadPtMin = 25;
+    float subleadPtMin = 20;
+    float etaMax = 2.5;
+    float mllMin = 60;
+    float mllMax = 120;
+    float projectedMETMax = 25;
+    float ptllMax = 40;
+    float dphillMin = 2.5;
+};
+
+// Stage 1: exactly two tight electrons with opposite charge. Sets lead/sublead (not yet pT ordered).
+inline CutStage tightElectronPairStage() {
+    return {"nElectron == 2 and opposite charge",
+            {"nElectron", "Electron_mvaFall17V2Iso_WP90", "Electron_pdgId"},
+            [](CutFlowEvent &ev) {
+                int tight[2] = {-1, -1};
+                int nTight = 0;
+                for (UInt_t j = 0; j < ev.nElectron; j++) {
+                    if (!ev.Electron_mvaFall17V2Iso_WP90[j]) continue;
+                    if (nTight < 2) tight[nTight] = j;
+                    nTight++;
+                }
+                if (nTight != 2) return false;
+                ev.lead = tight[0];
+                ev.sublead = tight[1];
+                return ev.Electron_pdgId[ev.lead] * ev.Electron_pdgId[ev.sublead] < 0;
+            }};
+}
+
+// Stage 2: both electrons within |η| < etaMax, the harder one above leadPtMin and the softer
+// one above subleadPtMin. Independent of the order of ev.lead and ev.sublead.
+inline CutStage electronAcceptanceStage(const DielectronCuts &cuts = DielectronCuts()) {
+    return {Form("|η| < %g and leading pₜ > %g GeV, subleading pₜ > %g GeV",
+                 cuts.etaMax, cuts.leadPtMin, cuts.subleadPtMin),
+            {"Electron_pt", "Electron_eta"},
+            [cuts](CutFlowEvent &ev) {
+                float pt1 = ev.Electron_pt[ev.lead], pt2 = ev.Electron_pt[ev.sublead];
+                return std::max(pt1, pt2) > cuts.leadPtMin && std::min(pt1, pt2) > cuts.subleadPtMin &&
+                       std::fabs(ev.Electron_eta[ev.lead]) < cuts.etaMax &&
+                       std::fabs(ev.Electron_eta[ev.sublead]) < cuts.etaMax;
+            }};
+}
+
+// The six stages of the analysis, in the order of the cut flow table
+inline std::vector<CutStage> dielectronCutStages(const DielectronCuts &cuts = DielectronCuts()) {
+    std::vector<CutStage> stages;
+    stages.push_back(tightElectronPairStage());
+    stages.push_back(electronAcceptanceStage(cuts));
+
+    stages.push_back({Form("dilepton mass %g < mₗₗ < %g GeV", cuts.mllMin, cuts.mllMax), {"mll"},
+                      [cuts](CutFlowEvent &ev) { return ev.mll > cuts.mllMin && ev.mll < cuts.mllMax; }});
+
+    stages.push_back({Form("projected MET < %g GeV", cuts.projectedMETMax),
+                      {"projected_MET"},
+                      [cuts](CutFlowEvent &ev) { return ev.projected_MET < cuts.projectedMETMax; }});
+
+    stages.push_back({Form("pₜ^ll < %g GeV", cuts.ptllMax), {"ptll"},
+                      [cuts](CutFlowEvent &ev) { return ev.ptll < cuts.ptllMax; }});
+
+    stages.push_back({Form("|Δφ_ll| > %g", cuts.dphillMin), {"dphill"},
+                      [cuts](CutFlowEvent &ev) { return ev.dphill > cuts.dphillMin; }});
+
+    return stages;
+}
+
+// Print counts, weighted counts and the I/O / compute time of every stage, in evaluation
+// order (times are summed over all worker threads)
+inline void printCutFlowResult(const std::string &sample, const std::vector<CutStage> &stages,
+                               const CutFlowResult &result) {
+    std::vector<size_t> order = result.order;
+    if (order.size() != result.stages.size()) {
+        order.resize(result.stages.size());
+        std::iota(order.begin(), order.end(), 0);
+    }
+
+    std::cout << "\n\nCut Flow results for " << sample << ":\n" << std::endl;
+    std::cout << "Total events in file " << result.nEntries << std::endl;
+    if (result.nMissing > 0) {
+        std::cout << "INCOMPLETE: " << result.nMissing << " more entries could not be read" << std::endl;
+    }
+    std::cout << "Weights: " << (result.weightBranch.empty() ? "none (unit weights)" : result.weightBranch) << std::endl;
+    for (size_t s : order) {
+        if (s >= stages.size()) continue;
+        const StageStats &st = result.stages[s];
+        std::cout << "Events after " << stages[s].name << ": " << st.passed
+                  << "  (weighted " << st.sumw << " ± " << std::sqrt(st.sumw2) << ")" << std::endl;
+    }
+    if (!order.empty()) {
+        std::cout << "\nFinal events passing all cuts: " << result.stages[order.back()].passed << std::endl;
+    }
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "\n" << std::setw(8) << "Stage" << std::setw(12) << "Reached" << std::setw(14) << "I/O [ms]"
+              << std::setw(14) << "Cut [ms]" << std::endl;
+    for (size_t s : order) {
+        const StageStats &st = result.stages[s];
+        std::cout << std::setw(8) << s + 1 << std::setw(12) << st.evaluated
+                  << std::setw(14) << std::fixed << std::setprecision(1) << 1e3 * st.ioSeconds
+                  << std::setw(14) << 1e3 * st.computeSeconds << std::endl;
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+    std::cout << "\n\n";
+}
+
+#endif
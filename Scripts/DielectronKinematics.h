@@ -0,0 +1,305 @@
+/*
+ * DielectronKinematics.h
+ *
+ * Description:
+ * Batch kinematics kernel shared by Electron_Cut_Flow.C, superimposed_plots.C and
+ * projected_MET.C. Dielectron candidates are stored as structure-of-arrays floats
+ * (pt, eta, phi of the two electrons) and processed a whole batch at a time, instead
+ * of building two TLorentzVector objects per event.
+ *
+ * Quantities:
+ *  - m_ll   = 2 sqrt(pt1 pt2 (sinh²(Δη/2) + sin²(Δφ/2)))   (massless electrons)
+ *  - pt_ll  = sqrt((pt1 - pt2)² + 4 pt1 pt2 cos²(Δφ/2))
+ *  - Δφ_ll  = |Δφ| wrapped into [0, π]
+ *  - projected MET and the signed Δφ(MET, e) used by projected_MET.C
+ *
+ * All functions are branchless: angles are wrapped with a rounding step instead of
+ * while loops, and sin/cos/exp are evaluated with Cephes-style polynomials, so the same
+ * code runs on 16 (AVX-512), 8 (AVX2) or 1 (scalar fallback) candidates at a time.
+ * The instruction set is chosen at compile time from the compiler flags; to get the
+ * vector version compile the macro with ACLiC and native flags, e.g.
+ *   root [0] gSystem->SetFlagsOpt("-O2 -march=native");
+ *   root [1] .L Electron_Cut_Flow.C++O
+ * Interpreted macros use the scalar fallback. kinematics_validation.C checks the
+ * results against TLorentzVector.
+ */
+
+#ifndef DIELECTRON_KINEMATICS_H
+#define DIELECTRON_KINEMATICS_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dielectron_kinematics {
+
+// ---------------------------------------------------------------------------------
+// Vector types. Each provides: construction from a float (broadcast), + - * /,
+// comparison masks, select, abs, sqrt, round, floor, 2^n, load and store.
+// ---------------------------------------------------------------------------------
+
+// Scalar fallback
+inline float vselect(bool m, float a, float b) { return m ? a : b; }
+inline bool vlt(float a, float b) { return a < b; }
+inline bool vand(bool a, bool b) { return a && b; }
+inline bool vor(bool a, bool b) { return a || b; }
+inline float vabs(float x) { return std::fabs(x); }
+inline float vsqrt(float x) { return std::sqrt(x); }
+inline float vround(float x) { return std::nearbyint(x); }
+inline float vfloor(float x) { return std::floor(x); }
+inline float vpow2i(float n) { return std::ldexp(1.0f, (int)n); }
+inline void vload(const float *p, float &x) { x = *p; }
+inline void vstore(float *p, float x) { *p = x; }
+
+#if defined(__AVX2__)
+struct VecAVX2 {
+    static const size_t width = 8;
+    __m256 v;
+    VecAVX2() = default;
+    VecAVX2(__m256 x) : v(x) {}
+    VecAVX2(float x) : v(_mm256_set1_ps(x)) {}
+};
+struct MaskAVX2 { __m256 m; };
+
+inline VecAVX2 operator+(VecAVX2 a, VecAVX2 b) { return _mm256_add_ps(a.v, b.v); }
+inline VecAVX2 operator-(VecAVX2 a, VecAVX2 b) { return _mm256_sub_ps(a.v, b.v); }
+inline VecAVX2 operator*(VecAVX2 a, VecAVX2 b) { return _mm256_mul_ps(a.v, b.v); }
+inline VecAVX2 operator/(VecAVX2 a, VecAVX2 b) { return _mm256_div_ps(a.v, b.v); }
+inline VecAVX2 operator-(VecAVX2 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline VecAVX2 vselect(MaskAVX2 m, VecAVX2 a, VecAVX2 b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+inline MaskAVX2 vlt(VecAVX2 a, VecAVX2 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline MaskAVX2 vand(MaskAVX2 a, MaskAVX2 b) { return {_mm256_and_ps(a.m, b.m)}; }
+inline MaskAVX2 vor(MaskAVX2 a, MaskAVX2 b) { return {_mm256_or_ps(a.m, b.m)}; }
+inline VecAVX2 vabs(VecAVX2 x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.v); }
+inline VecAVX2 vsqrt(VecAVX2 x) { return _mm256_sqrt_ps(x.v); }
+inline VecAVX2 vround(VecAVX2 x) { return _mm256_round_ps(x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline VecAVX2 vfloor(VecAVX2 x) { return _mm256_floor_ps(x.v); }
+inline VecAVX2 vpow2i(VecAVX2 n) {
+    __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+}
+inline void vload(const float *p, VecAVX2 &x) { x.v = _mm256_loadu_ps(p); }
+inline void vstore(float *p, VecAVX2 x) { _mm256_storeu_ps(p, x.v); }
+#endif
+
+#if defined(__AVX512F__)
+struct VecAVX512 {
+    static const size_t width = 16;
+    __m512 v;
+    VecAVX512() = default;
+    VecAVX512(__m512 x) : v(x) {}
+    VecAVX512(float x) : v(_mm512_set1_ps(x)) {}
+};
+struct MaskAVX512 { __mmask16 m; };
+
+inline VecAVX512 operator+(VecAVX512 a, VecAVX512 b) { return _mm512_add_ps(a.v, b.v); }
+inline VecAVX512 operator-(VecAVX512 a, VecAVX512 b) { return _mm512_sub_ps(a.v, b.v); }
+inline VecAVX512 operator*(VecAVX512 a, VecAVX512 b) { return _mm512_mul_ps(a.v, b.v); }
+inline VecAVX512 operator/(VecAVX512 a, VecAVX512 b) { return _mm512_div_ps(a.v, b.v); }
+inline VecAVX512 operator-(VecAVX512 a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+inline VecAVX512 vselect(MaskAVX512 m, VecAVX512 a, VecAVX512 b) { return _mm512_mask_blend_ps(m.m, b.v, a.v); }
+inline MaskAVX512 vlt(VecAVX512 a, VecAVX512 b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+inline MaskAVX512 vand(MaskAVX512 a, MaskAVX512 b) { return {(__mmask16)(a.m & b.m)}; }
+inline MaskAVX512 vor(MaskAVX512 a, MaskAVX512 b) { return {(__mmask16)(a.m | b.m)}; }
+inline VecAVX512 vabs(VecAVX512 x) { return _mm512_abs_ps(x.v); }
+inline VecAVX512 vsqrt(VecAVX512 x) { return _mm512_sqrt_ps(x.v); }
+inline VecAVX512 vround(VecAVX512 x) { return _mm512_roundscale_ps(x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline VecAVX512 vfloor(VecAVX512 x) { return _mm512_roundscale_ps(x.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+inline VecAVX512 vpow2i(VecAVX512 n) {
+    __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+}
+inline void vload(const float *p, VecAVX512 &x) { x.v = _mm512_loadu_ps(p); }
+inline void vstore(float *p, VecAVX512 x) { _mm512_storeu_ps(p, x.v); }
+#endif
+
+#if defined(__AVX512F__)
+typedef VecAVX512 NativeVec;
+inline const char *kernelISA() { return "AVX-512"; }
+#elif defined(__AVX2__)
+typedef VecAVX2 NativeVec;
+inline const char *kernelISA() { return "AVX2"; }
+#else
+inline const char *kernelISA() { return "scalar"; }
+#endif
+
+// ---------------------------------------------------------------------------------
+// Branchless maths, written once for every vector type
+// ---------------------------------------------------------------------------------
+
+const float kPi = 3.14159265358979f;
+const float kTwoPi = 6.28318530717959f;
+
+// Wrap an angle difference into (-π, π]
+template <class V>
+inline V wrapPhi(V dphi) {
+    V w = dphi - V(kTwoPi) * vround(dphi * V(1.0f / kTwoPi));
+    return vselect(vlt(V(-kPi), w), w, w + V(kTwoPi));
+}
+
+// sin and cos of x in [-π, π] (Cephes sinf/cosf polynomials, reduced by π/2)
+template <class V>
+inline void sinCos(V x, V &s, V &c) {
+    V j = vround(x * V(0.636619772367581f));
+    V r = ((x - j * V(1.5703125f)) - j * V(4.837512969970703125e-4f)) - j * V(7.54978995489188216e-8f);
+    V z = r * r;
+    V sr = r + r * z * (V(-1.6666654611e-1f) + z * (V(8.3321608736e-3f) + z * V(-1.9515295891e-4f)));
+    V cr = V(1.0f) - V(0.5f) * z
+         + z * z * (V(4.166664568298827e-2f) + z * (V(-1.388731625493765e-3f) + z * V(2.443315711809948e-5f)));
+
+    // Quadrant q = j mod 4: sin = {s, c, -s, -c}, cos = {c, -s, -c, s}
+    V q = j - V(4.0f) * vfloor(j * V(0.25f));
+    auto odd = vor(vlt(vabs(q - V(1.0f)), V(0.5f)), vlt(vabs(q - V(3.0f)), V(0.5f)));
+    V sq = vselect(odd, cr, sr);
+    V cq = vselect(odd, sr, cr);
+    s = vselect(vlt(V(1.5f), q), -sq, sq);
+    c = vselect(vlt(vabs(q - V(1.5f)), V(1.0f)), -cq, cq);
+}
+
+// e^x for |x| < 80 (Cephes expf)
+template <class V>
+inline V expApprox(V x) {
+    V n = vround(x * V(1.44269504088896341f));
+    V r = (x - n * V(0.693359375f)) - n * V(-2.12194440e-4f);
+    V z = r * r;
+    V p = ((((V(1.9875691500e-4f) * r + V(1.3981999507e-3f)) * r + V(8.3334519073e-3f)) * r
+           + V(4.1665795894e-2f)) * r + V(1.6666665459e-1f)) * r + V(5.0000001201e-1f);
+    return (p * z + r + V(1.0f)) * vpow2i(n);
+}
+
+// sinh(x), using the Taylor series near 0 where (e^x - e^-x)/2 cancels
+template <class V>
+inline V sinhApprox(V x) {
+    V z = x * x;
+    V taylor = x * (V(1.0f) + z * (V(1.0f / 6) + z * (V(1.0f / 120) + z * V(1.0f / 5040))));
+    V e = expApprox(vabs(x));
+    V big = V(0.5f) * (e - V(1.0f) / e);
+    big = vselect(vlt(x, V(0.0f)), -big, big);
+    return vselect(vlt(vabs(x), V(0.5f)), taylor, big);
+}
+
+template <class V>
+inline void dielectronBlock(const float *pt1, const float *eta1, const float *phi1,
+                            const float *pt2, const float *eta2, const float *phi2,
+                            float *mll, float *ptll, float *dphill) {
+    V a1, a2, e1, e2, p1, p2;
+    vload(pt1, a1); vload(eta1, e1); vload(phi1, p1);
+    vload(pt2, a2); vload(eta2, e2); vload(phi2, p2);
+
+    V dphi = wrapPhi(p1 - p2);
+    V sinHalf, cosHalf;
+    sinCos(V(0.5f) * dphi, sinHalf, cosHalf);
+    V shHalf = sinhApprox(V(0.5f) * (e1 - e2));
+
+    // cosh(Δη) - cos(Δφ) = 2 sinh²(Δη/2) + 2 sin²(Δφ/2), free of cancellation
+    V m2 = V(4.0f) * a1 * a2 * (shHalf * shHalf + sinHalf * sinHalf);
+    // pt1² + pt2² + 2 pt1 pt2 cos(Δφ) = (pt1 - pt2)² + 4 pt1 pt2 cos²(Δφ/2), no cancellation
+    // for back-to-back pairs
+    V dpt = a1 - a2;
+    V pt2sum = dpt * dpt + V(4.0f) * a1 * a2 * cosHalf * cosHalf;
+
+    vstore(mll, vsqrt(m2));
+    vstore(ptll, vsqrt(pt2sum));
+    vstore(dphill, vabs(dphi));
+}
+
+template <class V>
+inline void projectedMETBlock(const float *met, const float *metPhi, const float *phi1,
+                              const float *phi2, const float *nLep,
+                              float *dphi1, float *dphi2, float *dphimin, float *projMET) {
+    V m, mp, p1, p2, n;
+    vload(met, m); vload(metPhi, mp); vload(phi1, p1); vload(phi2, p2); vload(nLep, n);
+
+    auto hasLead = vlt(V(0.5f), n);
+    auto hasBoth = vlt(V(1.5f), n);
+    V d1 = vselect(hasLead, wrapPhi(mp - p1), V(0.0f));
+    V d2 = vselect(hasBoth, wrapPhi(mp - p2), V(0.0f));
+
+    // Smallest |Δφ|, sign preserved
+    V dmin = vselect(vand(hasBoth, vlt(vabs(d2), vabs(d1))), d2, d1);
+    V absMin = vabs(dmin);
+    V s, c;
+    sinCos(absMin, s, c);
+    V pmet = vselect(vand(hasBoth, vlt(absMin, V(0.5f * kPi))), m * s, m);
+    pmet = vselect(hasLead, pmet, V(0.0f));
+
+    vstore(dphi1, d1);
+    vstore(dphi2, d2);
+    vstore(dphimin, dmin);
+    vstore(projMET, pmet);
+}
+
+} // namespace dielectron_kinematics
+
+// ---------------------------------------------------------------------------------
+// Batch interface used by the macros
+// ---------------------------------------------------------------------------------
+
+// m_ll, pt_ll and |Δφ_ll| of n candidates (electron 1 and 2 in any order)
+inline void dielectronKinematics(const float *pt1, const float *eta1, const float *phi1,
+                                 const float *pt2, const float *eta2, const float *phi2, size_t n,
+                                 float *mll, float *ptll, float *dphill) {
+    using namespace dielectron_kinematics;
+    size_t i = 0;
+#if defined(__AVX512F__) || defined(__AVX2__)
+    for (; i + NativeVec::width <= n; i += NativeVec::width) {
+        dielectronBlock<NativeVec>(pt1 + i, eta1 + i, phi1 + i, pt2 + i, eta2 + i, phi2 + i,
+                                   mll + i, ptll + i, dphill + i);
+    }
+#endif
+    for (; i < n; i++) {
+        dielectronBlock<float>(pt1 + i, eta1 + i, phi1 + i, pt2 + i, eta2 + i, phi2 + i,
+                               mll + i, ptll + i, dphill + i);
+    }
+}
+
+// Signed Δφ(MET, leading e), Δφ(MET, subleading e), the one with the smallest |Δφ| and
+// the projected MET of n events. nLep is the number of electrons (0, 1 or 2+) as a float;
+// missing electrons give Δφ = 0, and projected MET = MET (one electron) or 0 (none).
+inline void projectedMETKinematics(const float *met, const float *metPhi, const float *phi1,
+                                   const float *phi2, const float *nLep, size_t n,
+                                   float *dphi1, float *dphi2, float *dphimin, float *projMET) {
+    using namespace dielectron_kinematics;
+    size_t i = 0;
+#if defined(__AVX512F__) || defined(__AVX2__)
+    for (; i + NativeVec::width <= n; i += NativeVec::width) {
+        projectedMETBlock<NativeVec>(met + i, metPhi + i, phi1 + i, phi2 + i, nLep + i,
+                                     dphi1 + i, dphi2 + i, dphimin + i, projMET + i);
+    }
+#endif
+    for (; i < n; i++) {
+        projectedMETBlock<float>(met + i, metPhi + i, phi1 + i, phi2 + i, nLep + i,
+                                 dphi1 + i, dphi2 + i, dphimin + i, projMET + i);
+    }
+}
+
+// Structure-of-arrays batch of dielectron candidates, electron 1 = leading
+struct DielectronBatch {
+    std::vector<float> pt1, eta1, phi1, pt2, eta2, phi2;
+    std::vector<float> mll, ptll, dphill;   // filled by compute()
+
+    size_t size() const { return pt1.size(); }
+
+    void clear() {
+        pt1.clear(); eta1.clear(); phi1.clear();
+        pt2.clear(); eta2.clear(); phi2.clear();
+    }
+
+    void push_back(float ptLead, float etaLead, float phiLead, float ptSub, float etaSub, float phiSub) {
+        pt1.push_back(ptLead); eta1.push_back(etaLead); phi1.push_back(phiLead);
+        pt2.push_back(ptSub); eta2.push_back(etaSub); phi2.push_back(phiSub);
+    }
+
+    void compute() {
+        size_t n = size();
+        mll.resize(n); ptll.resize(n); dphill.resize(n);
+        dielectronKinematics(pt1.data(), eta1.data(), phi1.data(), pt2.data(), eta2.data(), phi2.data(), n,
+                             mll.data(), ptll.data(), dphill.data());
+    }
+};
+
+#endif
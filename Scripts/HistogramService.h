@@ -0,0 +1,247 @@
+/*
+ * HistogramService.h
+ *
+ * Description:
+ * Histogram production for the dielectron candidates, separated from drawing.
+ *  - Histograms are declared once as a HistogramSpec: name, title/axis labels, binning,
+ *    the variable to fill and an optional selection on the candidate.
+ *  - fillHistograms() fills every declared histogram for every sample in one concurrent pass:
+ *    the cluster ranges of all samples are shared by a ROOT::TThreadExecutor pool, each
+ *    thread fills its own copy of the histograms (ROOT::TThreadedObject, no locking) and the
+ *    copies are merged at the end.
+ *  - The raw (unnormalized, unstyled) histograms are written to a cache file with one
+ *    directory per sample, "<sample>/<spec name>", so plots can be restyled and redrawn
+ *    from the cache alone (see render_histograms() in superimposed_plots.C).
+ *  - Optionally every spec is filled once per PuppiMET variation (metVariations()), with the
+ *    candidate's projectedMET taken from projected_MET_<variation>; these histograms go to
+ *    "<sample>/<variation>/<spec name>". All variations are filled in the same pass.
+ *
+ * Candidates are events with exactly two tight opposite-sign electrons (stage 1 of the cut
+ * flow, read through the pre-selection cache); their kinematics come from the SIMD kernel.
+ */
+
+#ifndef HISTOGRAM_SERVICE_H
+#define HISTOGRAM_SERVICE_H
+
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TH1F.h>
+#include <TROOT.h>
+#include <TTree.h>
+#include <ROOT/TSeq.hxx>
+#include <ROOT/TThreadExecutor.hxx>
+#include <ROOT/TThreadedObject.hxx>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnalysisCommon.h"
+#include "CutFlowPipeline.h"
+#include "DielectronKinematics.h"
+#include "PreselectionCache.h"
+
+// Quantities of one dielectron candidate available to the histogram declarations
+struct DielectronCandidate {
+    float ptLead, etaLead, phiLead;
+    float ptSub, etaSub, phiSub;
+    float mll, ptll, dphill;
+    float projectedMET;
+};
+
+struct HistogramSpec {
+    std::string name;    // histogram name in the cache file
+    std::string title;   // "title; x axis; y axis"
+    int nBins;
+    double xMin, xMax;
+    std::function<float(const DielectronCandidate &)> variable;
+    std::function<bool(const DielectronCandidate &)> selection;   // nullptr: every candidate
+};
+
+// Candidate selection equivalent to stages 2-6 of the cut flow
+inline std::function<bool(const DielectronCandidate &)> passesDielectronCuts(const DielectronCuts &cuts = DielectronCuts()) {
+    return [cuts](const DielectronCandidate &c) {
+        return c.ptLead > cuts.leadPtMin && c.ptSub > cuts.subleadPtMin &&
+               std::fabs(c.etaLead) < cuts.etaMax && std::fabs(c.etaSub) < cuts.etaMax &&
+               c.mll > cuts.mllMin && c.mll < cuts.mllMax && c.projectedMET < cuts.projectedMETMax &&
+               c.ptll < cuts.ptllMax && c.dphill > cuts.dphillMin;
+    };
+}
+
+// The distributions drawn by superimposed_plots()
+inline std::vector<HistogramSpec> dielectronHistograms() {
+    return {
+        {"mll",      "  ; m_{ll} [GeV]; Normalized Events",                  30, 60, 120,  [](const DielectronCandidate &c) { return c.mll; }, nullptr},
+        {"ptll",     "  ; p_{T}^{ll} [GeV]; Normalized Events",              25, 0, 100,   [](const DielectronCandidate &c) { return c.ptll; }, nullptr},
+        {"met",      "  ; Projected MET [GeV]; Normalized Events",           25, 0, 100,   [](const DielectronCandidate &c) { return c.projectedMET; }, nullptr},
+        {"dphill",   "  ; #Delta#phi_{ll}; Normalized Events",               30, 0, 3.14,  [](const DielectronCandidate &c) { return c.dphill; }, nullptr},
+        {"pt_lead",  "Leading Electron p_{T}; p_{T}^{lead} [GeV]; Normalized Events", 25, 0, 100, [](const DielectronCandidate &c) { return c.ptLead; }, nullptr},
+        {"pt_sub",   "Subleading Electron p_{T}; p_{T}^{sub} [GeV]; Normalized Events", 25, 0, 100, [](const DielectronCandidate &c) { return c.ptSub; }, nullptr},
+        {"eta_lead", "Leading Electron #eta; #eta^{lead}; Normalized Events", 30, -3, 3,   [](const DielectronCandidate &c) { return c.etaLead; }, nullptr},
+        {"eta_sub",  "Subleading Electron #eta; #eta^{sub}; Normalized Events", 30, -3, 3, [](const DielectronCandidate &c) { return c.etaSub; }, nullptr}
+    };
+}
+
+// "DYtoLL_M50.root" -> "DYtoLL_M50", the directory of the sample in the cache file
+inline std::string sampleLabel(const std::string &sample) {
+    return siblingFile(sample, "");
+}
+
+// One thread-local histogram set per (sample, variation, spec), at [sample][v * specs.size() + h]
+typedef ROOT::TThreadedObject<TH1F> ThreadedHist;
+typedef std::vector<std::vector<std::unique_ptr<ThreadedHist>>> ThreadedHistograms;
+
+inline ThreadedHistograms bookHistograms(const std::vector<std::string> &samples, const std::vector<HistogramSpec> &specs,
+                                         const std::vector<std::string> &variations) {
+    ThreadedHistograms hists(samples.size());
+    for (size_t s = 0; s < samples.size(); s++) {
+        for (const auto &v : variations) {
+            for (const auto &spec : specs) {
+                std::string name = spec.name + "_" + sampleLabel(samples[s]) + (v.empty() ? "" : "_" + v);
+                hists[s].emplace_back(new ThreadedHist(name.c_str(), spec.title.c_str(), spec.nBins, spec.xMin, spec.xMax));
+            }
+        }
+    }
+    return hists;
+}
+
+// Merge the thread-local copies and write them to 'cacheName' as "<sample>/<spec name>" for the
+// nominal variation ("") and "<sample>/<variation>/<spec name>" for the others
+inline bool writeHistograms(const std::string &cacheName, const std::vector<std::string> &samples,
+                            const std::vector<HistogramSpec> &specs, const std::vector<std::string> &variations,
+                            ThreadedHistograms &hists) {
+    TFile *cache = TFile::Open(cacheName.c_str(), "RECREATE");
+    if (!cache || cache->IsZombie()) {
+        std::cerr << "Error: Could not create " << cacheName << std::endl;
+        delete cache;
+        return false;
+    }
+    for (size_t s = 0; s < samples.size(); s++) {
+        TDirectory *sampleDir = cache->mkdir(sampleLabel(samples[s]).c_str());
+        for (size_t v = 0; v < variations.size(); v++) {
+            TDirectory *dir = variations[v].empty() ? sampleDir : sampleDir->mkdir(variations[v].c_str());
+            dir->cd();
+            for (size_t h = 0; h < specs.size(); h++) {
+                ThreadedHist &hist = *hists[s][v * specs.size() + h];
+                hist.Get();   // a (possibly empty) copy exists even for a sample without ranges
+                std::shared_ptr<TH1F> merged = hist.Merge();
+                merged->SetName(specs[h].name.c_str());
+                merged->Write();
+            }
+        }
+    }
+    cache->Close();
+    delete cache;
+
+    std::cout << "Histograms of " << samples.size() << " samples written to " << cacheName << std::endl;
+    return true;
+}
+
+// Fill every spec for every sample and write the merged histograms to 'cacheName'.
+// 'scales' multiplies the entries of each sample (default 1). 'variations' lists the MET
+// variations to fill, "" being the nominal projected_MET. Returns false if the cache file
+// cannot be written.
+inline bool fillHistograms(const std::vector<std::string> &samples, const std::vector<HistogramSpec> &specs,
+                           const std::string &cacheName, UInt_t nThreads = 0, std::vector<double> scales = {},
+                           const std::vector<std::string> &variations = {""}) {
+    ROOT::EnableThreadSafety();
+    if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+    scales.resize(samples.size(), 1.0);
+
+    // Index of each variation in CutFlowEvent::projected_MET_variation, -1 for the nominal value
+    std::vector<std::string> known = metVariations();
+    std::vector<int> variationIndex;
+    std::vector<std::string> outputs = {"Electron_pt", "Electron_eta", "Electron_phi", "projected_MET"};
+    for (const auto &v : variations) {
+        int index = std::find(known.begin(), known.end(), v) - known.begin();
+        if (v.empty()) {
+            index = -1;
+        } else if (index == kNMETVariations) {
+            std::cerr << "Error: unknown MET variation '" << v << "'" << std::endl;
+            return false;
+        } else {
+            outputs.push_back("projected_MET_" + v);
+        }
+        variationIndex.push_back(index);
+    }
+
+    std::vector<PreselectedEntries> preselected;
+    std::vector<bool> hasPreselection;
+    loadPreselections(samples, nThreads, preselected, hasPreselection);
+
+    // Samples without the requested MET variations are skipped
+    std::vector<std::string> required(outputs.begin() + 4, outputs.end());
+    std::vector<EntryRange> ranges = analysisRanges(samples, nThreads, required);
+
+    ThreadedHistograms hists = bookHistograms(samples, specs, variations);
+
+    CutFlowPipeline preselection({tightElectronPairStage()});
+
+    auto processRange = [&](unsigned int r) {
+        const EntryRange &range = ranges[r];
+        TFile *file = TFile::Open(samples[range.sample].c_str());
+        TTree *tree = file ? (TTree*)file->Get("Events") : nullptr;
+        if (!tree || !attachProjectedMETFriend(tree, samples[range.sample])) {
+            delete file;
+            return;
+        }
+
+        // This thread's copies
+        std::vector<std::shared_ptr<TH1F>> local;
+        for (auto &h : hists[range.sample]) local.push_back(h->Get());
+        double scale = scales[range.sample];
+
+        // Candidates are collected and their dilepton kinematics computed in batches
+        // (the electron kinematics are shared by all MET variations)
+        DielectronBatch batch;
+        std::vector<std::vector<float>> batchMET(variations.size());
+        std::vector<float> batchWeight;
+        auto fillBatch = [&]() {
+            batch.compute();
+            for (size_t k = 0; k < batch.size(); k++) {
+                DielectronCandidate c = {batch.pt1[k], batch.eta1[k], batch.phi1[k],
+                                         batch.pt2[k], batch.eta2[k], batch.phi2[k],
+                                         batch.mll[k], batch.ptll[k], batch.dphill[k], 0};
+                for (size_t v = 0; v < variations.size(); v++) {
+                    c.projectedMET = batchMET[v][k];
+                    for (size_t h = 0; h < specs.size(); h++) {
+                        if (specs[h].selection && !specs[h].selection(c)) continue;
+                        local[v * specs.size() + h]->Fill(specs[h].variable(c), scale * batchWeight[k]);
+                    }
+                }
+            }
+            batch.clear();
+            for (auto &m : batchMET) m.clear();
+            batchWeight.clear();
+        };
+
+        auto onPass = [&](const CutFlowEvent &ev) {
+            int lead = (ev.Electron_pt[ev.lead] > ev.Electron_pt[ev.sublead]) ? ev.lead : ev.sublead;
+            int sub  = (lead == ev.lead) ? ev.sublead : ev.lead;
+            batch.push_back(ev.Electron_pt[lead], ev.Electron_eta[lead], ev.Electron_phi[lead],
+                            ev.Electron_pt[sub], ev.Electron_eta[sub], ev.Electron_phi[sub]);
+            for (size_t v = 0; v < variations.size(); v++) {
+                int index = variationIndex[v];
+                batchMET[v].push_back(index < 0 ? ev.projected_MET : ev.projected_MET_variation[index]);
+            }
+            batchWeight.push_back(ev.weight);
+            if (batch.size() == kCutFlowBatchSize) fillBatch();
+        };
+
+        const PreselectedEntries *sel = hasPreselection[range.sample] ? &preselected[range.sample] : nullptr;
+        preselection.Run(tree, range.first, range.last, outputs, onPass, sel);
+        fillBatch();
+        delete file;
+    };
+
+    ROOT::TThreadExecutor pool(nThreads);
+    pool.Foreach(processRange, ROOT::TSeqU(ranges.size()));
+
+    return writeHistograms(cacheName, samples, specs, variations, hists);
+}
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * PreselectionCache.h
+ *
+ * Description:
+ * Persistent cache of the "two tight opposite-sign electrons" pre-selection.
+ * Every macro starts by scanning all entries for exactly two
+ * Electron_mvaFall17V2Iso_WP90 electrons with opposite pdgId; in DY most events fail.
+ * The entry numbers that pass, with the pT-ordered lead/sublead electron indices, are
+ * stored next to the input file in "<sample>_presel.root":
+ *   - TTree "presel" with branches entry (Long64_t), lead and sublead (UChar_t),
+ *   - TNamed "key": UUID, size and modification time of the input file,
+ *   - TNamed "selection": name of the cut stage the list was built with.
+ * getPreselection() returns the cached list if the key and the selection still match and
+ * rebuilds it (in parallel over cluster ranges) otherwise. CutFlowPipeline::Run then reads
+ * only the surviving entries.
+ */
+
+#ifndef PRESELECTION_CACHE_H
+#define PRESELECTION_CACHE_H
+
+#include <TFile.h>
+#include <TNamed.h>
+#include <TROOT.h>
+#include <TSystem.h>
+#include <TTree.h>
+#include <TUUID.h>
+#include <ROOT/TSeq.hxx>
+#include <ROOT/TThreadExecutor.hxx>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnalysisCommon.h"
+#include "CutFlowPipeline.h"
+
+// "DYtoLL_M50.root" -> "DYtoLL_M50_presel.root"
+inline std::string preselectionCacheFile(const std::string &sample) {
+    return siblingFile(sample, "_presel.root");
+}
+
+// Identity of the input file: UUID, size and modification time. Empty if it cannot be opened.
+inline std::string preselectionCacheKey(const std::string &sample) {
+    FileStat_t stat;
+    if (gSystem->GetPathInfo(sample.c_str(), stat) != 0) return "";
+
+    TFile *file = TFile::Open(sample.c_str());
+    if (!file || file->IsZombie()) {
+        delete file;
+        return "";
+    }
+    std::string key = Form("%s size=%lld mtime=%ld", file->GetUUID().AsString(), file->GetSize(), stat.fMtime);
+    delete file;
+    return key;
+}
+
+// Read the cache of 'sample'. Returns false if it is missing, stale or built with another selection.
+inline bool loadPreselectionCache(const std::string &sample, const std::string &key, PreselectedEntries &out) {
+    std::string cacheName = preselectionCacheFile(sample);
+    if (key.empty() || gSystem->AccessPathName(cacheName.c_str())) return false;
+
+    TFile *file = TFile::Open(cacheName.c_str());
+    if (!file || file->IsZombie()) {
+        delete file;
+        return false;
+    }
+
+    TNamed *storedKey = (TNamed*)file->Get("key");
+    TNamed *storedSelection = (TNamed*)file->Get("selection");
+    TTree *tree = (TTree*)file->Get("presel");
+    bool valid = storedKey && storedSelection && tree && key == storedKey->GetTitle() &&
+                 out.selection == storedSelection->GetTitle();
+
+    if (valid) {
+        Long64_t entry;
+        UChar_t lead, sublead;
+        tree->SetBranchAddress("entry", &entry);
+        tree->SetBranchAddress("lead", &lead);
+        tree->SetBranchAddress("sublead", &sublead);
+
+        Long64_t n = tree->GetEntries();
+        out.entries.resize(n);
+        out.lead.resize(n);
+        out.sublead.resize(n);
+        for (Long64_t i = 0; i < n; i++) {
+            tree->GetEntry(i);
+            out.entries[i] = entry;
+            out.lead[i] = lead;
+            out.sublead[i] = sublead;
+        }
+    }
+
+    delete file;
+    return valid;
+}
+
+inline bool savePreselectionCache(const std::string &sample, const std::string &key, const PreselectedEntries &sel) {
+    std::string cacheName = preselectionCacheFile(sample);
+    TFile *file = TFile::Open(cacheName.c_str(), "RECREATE");
+    if (!file || file->IsZombie()) {
+        std::cerr << "Error: Could not create " << cacheName << std::endl;
+        delete file;
+        return false;
+    }
+
+    Long64_t entry;
+    UChar_t lead, sublead;
+    TTree *tree = new TTree("presel", "Entries passing the dielectron pre-selection");
+    tree->Branch("entry", &entry, "entry/L");
+    tree->Branch("lead", &lead, "lead/b");
+    tree->Branch("sublead", &sublead, "sublead/b");
+    for (size_t i = 0; i < sel.entries.size(); i++) {
+        entry = sel.entries[i];
+        lead = sel.lead[i];
+        sublead = sel.sublead[i];
+        tree->Fill();
+    }
+
+    file->cd();
+    tree->Write();
+    TNamed("key", key.c_str()).Write();
+    TNamed("selection", sel.selection.c_str()).Write();
+    file->Close();
+    delete file;
+    return true;
+}
+
+// Scan 'sample' with the pre-selection stage, concurrently over cluster ranges.
+// Returns false if any range could not be read in full: the list would miss its entries.
+inline bool buildPreselection(const std::string &sample, PreselectedEntries &out, UInt_t nThreads) {
+    ROOT::EnableThreadSafety();
+    if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+
+    TFile *file = TFile::Open(sample.c_str());
+    if (!file || file->IsZombie()) {
+        std::cerr << "Error opening the ROOT file " << sample << std::endl;
+        delete file;
+        return false;
+    }
+    TTree *tree = (TTree*)file->Get("Events");
+    std::vector<EntryRange> ranges;
+    if (tree) appendClusterRanges(tree, 0, 4 * nThreads, ranges);
+    delete file;
+    if (!tree) {
+        std::cerr << "Error getting the TTree from the ROOT file " << sample << std::endl;
+        return false;
+    }
+
+    CutFlowPipeline preselection({tightElectronPairStage()});
+    std::vector<PreselectedEntries> partial(ranges.size());
+    std::vector<char> complete(ranges.size(), 0);
+    auto processRange = [&](unsigned int r) {
+        TFile *in = TFile::Open(sample.c_str());
+        TTree *t = (in && !in->IsZombie()) ? (TTree*)in->Get("Events") : nullptr;
+        if (t) {
+            PreselectedEntries &sel = partial[r];
+            CutFlowResult result = preselection.Run(t, ranges[r].first, ranges[r].last, {"Electron_pt"}, [&](const CutFlowEvent &ev) {
+                bool ordered = ev.Electron_pt[ev.lead] > ev.Electron_pt[ev.sublead];
+                sel.entries.push_back(ev.entry);
+                sel.lead.push_back(ordered ? ev.lead : ev.sublead);
+                sel.sublead.push_back(ordered ? ev.sublead : ev.lead);
+            });
+            // Run() returns before the first entry if a branch cannot be bound
+            complete[r] = result.stages[0].evaluated == ranges[r].last - ranges[r].first;
+        }
+        delete in;
+    };
+
+    ROOT::TThreadExecutor pool(nThreads);
+    pool.Foreach(processRange, ROOT::TSeqU(ranges.size()));
+
+    for (size_t r = 0; r < ranges.size(); r++) {
+        if (!complete[r]) {
+            std::cerr << "Error: entries " << ranges[r].first << "-" << ranges[r].last << " of " << sample
+                      << " could not be read, pre-selection not built" << std::endl;
+            return false;
+        }
+    }
+
+    // Ranges are in entry order, so concatenating keeps the list sorted
+    out.entries.clear();
+    out.lead.clear();
+    out.sublead.clear();
+    for (const auto &sel : partial) {
+        out.entries.insert(out.entries.end(), sel.entries.begin(), sel.entries.end());
+        out.lead.insert(out.lead.end(), sel.lead.begin(), sel.lead.end());
+        out.sublead.insert(out.sublead.end(), sel.sublead.begin(), sel.sublead.end());
+    }
+    return true;
+}
+
+// Pre-selected entries of 'sample', from the cache file if it is up to date, otherwise
+// rebuilt and written back. Returns false if the sample cannot be read in full; an
+// incomplete list is neither returned nor cached.
+inline bool getPreselection(const std::string &sample, PreselectedEntries &out, UInt_t nThreads = 0) {
+    out.selection = tightElectronPairStage().name;
+    std::string key = preselectionCacheKey(sample);
+    if (key.empty()) return false;
+    if (loadPreselectionCache(sample, key, out)) return true;
+
+    std::cout << "Building pre-selection cache for " << sample << std::endl;
+    if (!buildPreselection(sample, out, nThreads)) return false;
+    savePreselectionCache(sample, key, out);
+    return true;
+}
+
+// Pre-selected entries of every sample; hasPreselection[s] is false if sample s has none
+inline void loadPreselections(const std::vector<std::string> &samples, UInt_t nThreads,
+                              std::vector<PreselectedEntries> &preselected, std::vector<bool> &hasPreselection) {
+    preselected.assign(samples.size(), PreselectedEntries());
+    hasPreselection.assign(samples.size(), false);
+    for (size_t s = 0; s < samples.size(); s++) {
+        hasPreselection[s] = getPreselection(samples[s], preselected[s], nThreads);
+    }
+}
+
+#endif